@@ -1,6 +1,9 @@
 #include "OO_SIMD.h"
 
+#include <cmath>
+
 using namespace std;
+using namespace oo_simd_detail;
 
 template <typename T>
 vectorRegister<T>::vectorRegister() {
@@ -630,3 +633,960 @@ vectorRegister<T> vectorRegister<T>::operator+(const vectorRegister<T>& rhs) con
 template class vectorRegister<int>;
 template class vectorRegister<float>;
 template class vectorRegister<double>;
+
+
+// Widest integer dot product path the CPU can run.
+// 0 : scalar, 1 : SSE2, 2 : AVX2, 3 : AVX512 VNNI
+static int detectIntegerDotExtension() {
+    #if defined(__AVX512VNNI__)
+        if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512vnni")) {
+            return 3;
+        }
+    #endif
+
+    #if defined(__AVX2__)
+        if (__builtin_cpu_supports("avx2")) {
+            return 2;
+        }
+    #endif
+
+    #if defined(__SSE2__)
+        if (__builtin_cpu_supports("sse2")) {
+            return 1;
+        }
+    #endif
+
+    return 0;
+}
+
+static int integerDotExtension() {
+    static const int extension = detectIntegerDotExtension();
+    return extension;
+}
+
+#if defined(__SSE2__)
+static int horizontalSumEpi32(__m128i sum) {
+    sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(1, 0, 3, 2)));
+    sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(2, 3, 0, 1)));
+    return _mm_cvtsi128_si32(sum);
+}
+#endif
+
+#if defined(__AVX512VNNI__)
+// _mm512_reduce_add_epi32 finishes with scalar int adds, which can overflow;
+// this stays in vector adds so the sum wraps like the rest of the kernel.
+static int horizontalSumEpi32(__m512i sum) {
+    __m256i half = _mm256_add_epi32(_mm512_castsi512_si256(sum), _mm512_extracti64x4_epi64(sum, 1));
+    return horizontalSumEpi32(_mm_add_epi32(_mm256_castsi256_si128(half), _mm256_extracti128_si256(half, 1)));
+}
+#endif
+
+// The VNNI int8 path multiplies unsigned by signed bytes, so lhs is biased by
+// 128 and 128 * sum(rhs) has to be taken back out. This returns that
+// correction for the part of rhs the VNNI loop covers (whole 64 byte blocks),
+// or 0 when the VNNI path is not used. It only depends on rhs, so GEMV computes
+// it once for every row.
+static uint32_t int8BiasCorrection(const int8_t *rhs, int length) {
+    uint32_t correction = 0;
+
+    if (integerDotExtension() >= 3) {
+        #if defined(__AVX512VNNI__)
+        const __m512i ones = _mm512_set1_epi8(1);
+        __m512i rhsSum = _mm512_setzero_si512();
+        for (int i = 0; i + 64 <= length; i += 64) {
+            rhsSum = _mm512_dpbusd_epi32(rhsSum, ones, _mm512_loadu_si512((const void*)(rhs + i)));
+        }
+        correction = (uint32_t)horizontalSumEpi32(_mm512_slli_epi32(rhsSum, 7));
+        #endif
+    }
+    return correction;
+}
+
+// maddubs is not used on the AVX2 / SSE2 paths : its u8 * s8 pair sums saturate
+// at 16 bits, which would break bit exactness with the VNNI and scalar paths.
+// Sign extending to 16 bits and using madd is exact.
+static int dotInt8Kernel(const int8_t *lhs, const int8_t *rhs, int length, uint32_t biasCorrection) {
+    // accumulated unsigned so the scalar tail wraps modulo 2^32 like the SIMD paths.
+    uint32_t result = 0;
+    int i = 0;
+
+    // each path takes whole registers and leaves the remainder to the next
+    // narrower one, down to the scalar tail.
+    int extension = integerDotExtension();
+
+    if (extension >= 3) {
+        #if defined(__AVX512VNNI__)
+        // biasCorrection comes from int8BiasCorrection for the same rhs.
+        const __m512i bias = _mm512_set1_epi8((char)0x80);
+        __m512i acc = _mm512_setzero_si512();
+        for (; i + 64 <= length; i += 64) {
+            __m512i a = _mm512_xor_si512(_mm512_loadu_si512((const void*)(lhs + i)), bias);
+            __m512i b = _mm512_loadu_si512((const void*)(rhs + i));
+            acc = _mm512_dpbusd_epi32(acc, a, b);
+        }
+        result += (uint32_t)horizontalSumEpi32(acc) - biasCorrection;
+        #endif
+    }
+
+    if (extension >= 2) {
+        #if defined(__AVX2__)
+        __m256i acc = _mm256_setzero_si256();
+        for (; i + 16 <= length; i += 16) {
+            __m256i a = _mm256_cvtepi8_epi16(_mm_loadu_si128((const __m128i*)(lhs + i)));
+            __m256i b = _mm256_cvtepi8_epi16(_mm_loadu_si128((const __m128i*)(rhs + i)));
+            acc = _mm256_add_epi32(acc, _mm256_madd_epi16(a, b));
+        }
+        result += (uint32_t)horizontalSumEpi32(_mm_add_epi32(_mm256_castsi256_si128(acc), _mm256_extracti128_si256(acc, 1)));
+        #endif
+    }
+
+    if (extension >= 1) {
+        #if defined(__SSE2__)
+        const __m128i zero = _mm_setzero_si128();
+        __m128i acc = _mm_setzero_si128();
+        for (; i + 16 <= length; i += 16) {
+            __m128i a = _mm_loadu_si128((const __m128i*)(lhs + i));
+            __m128i b = _mm_loadu_si128((const __m128i*)(rhs + i));
+            __m128i aSign = _mm_cmpgt_epi8(zero, a);
+            __m128i bSign = _mm_cmpgt_epi8(zero, b);
+            acc = _mm_add_epi32(acc, _mm_madd_epi16(_mm_unpacklo_epi8(a, aSign), _mm_unpacklo_epi8(b, bSign)));
+            acc = _mm_add_epi32(acc, _mm_madd_epi16(_mm_unpackhi_epi8(a, aSign), _mm_unpackhi_epi8(b, bSign)));
+        }
+        // one half register step for the remainder left by the 16 byte paths.
+        if (i + 8 <= length) {
+            __m128i a = _mm_loadl_epi64((const __m128i*)(lhs + i));
+            __m128i b = _mm_loadl_epi64((const __m128i*)(rhs + i));
+            a = _mm_unpacklo_epi8(a, _mm_cmpgt_epi8(zero, a));
+            b = _mm_unpacklo_epi8(b, _mm_cmpgt_epi8(zero, b));
+            acc = _mm_add_epi32(acc, _mm_madd_epi16(a, b));
+            i += 8;
+        }
+        result += (uint32_t)horizontalSumEpi32(acc);
+        #endif
+    }
+
+    for (; i < length; i++) {
+        result += (uint32_t)((int)lhs[i] * (int)rhs[i]);
+    }
+    return (int)result;
+}
+
+static int dotInt16Kernel(const int16_t *lhs, const int16_t *rhs, int length) {
+    // accumulated unsigned so the scalar tail wraps modulo 2^32 like the SIMD paths.
+    uint32_t result = 0;
+    int i = 0;
+
+    // each path takes whole registers and leaves the remainder to the next
+    // narrower one, down to the scalar tail.
+    int extension = integerDotExtension();
+
+    if (extension >= 3) {
+        #if defined(__AVX512VNNI__)
+        __m512i acc = _mm512_setzero_si512();
+        for (; i + 32 <= length; i += 32) {
+            __m512i a = _mm512_loadu_si512((const void*)(lhs + i));
+            __m512i b = _mm512_loadu_si512((const void*)(rhs + i));
+            acc = _mm512_dpwssd_epi32(acc, a, b);
+        }
+        result += (uint32_t)horizontalSumEpi32(acc);
+        #endif
+    }
+
+    if (extension >= 2) {
+        #if defined(__AVX2__)
+        __m256i acc = _mm256_setzero_si256();
+        for (; i + 16 <= length; i += 16) {
+            __m256i a = _mm256_loadu_si256((const __m256i*)(lhs + i));
+            __m256i b = _mm256_loadu_si256((const __m256i*)(rhs + i));
+            acc = _mm256_add_epi32(acc, _mm256_madd_epi16(a, b));
+        }
+        result += (uint32_t)horizontalSumEpi32(_mm_add_epi32(_mm256_castsi256_si128(acc), _mm256_extracti128_si256(acc, 1)));
+        #endif
+    }
+
+    if (extension >= 1) {
+        #if defined(__SSE2__)
+        __m128i acc = _mm_setzero_si128();
+        for (; i + 8 <= length; i += 8) {
+            __m128i a = _mm_loadu_si128((const __m128i*)(lhs + i));
+            __m128i b = _mm_loadu_si128((const __m128i*)(rhs + i));
+            acc = _mm_add_epi32(acc, _mm_madd_epi16(a, b));
+        }
+        result += (uint32_t)horizontalSumEpi32(acc);
+        #endif
+    }
+
+    for (; i < length; i++) {
+        result += (uint32_t)((int)lhs[i] * (int)rhs[i]);
+    }
+    return (int)result;
+}
+
+int dotProductInt8(const vector<int8_t> &lhs, const vector<int8_t> &rhs) {
+    if (lhs.size() != rhs.size()) {
+        throw invalid_argument("You cannot take the dot product of two vectors of different sizes.");
+    }
+    return dotInt8Kernel(lhs.data(), rhs.data(), lhs.size(), int8BiasCorrection(rhs.data(), rhs.size()));
+}
+
+int dotProductInt16(const vector<int16_t> &lhs, const vector<int16_t> &rhs) {
+    if (lhs.size() != rhs.size()) {
+        throw invalid_argument("You cannot take the dot product of two vectors of different sizes.");
+    }
+    return dotInt16Kernel(lhs.data(), rhs.data(), lhs.size());
+}
+
+vector<int> gemvInt8(const vector<int8_t> &matrix, const vector<int8_t> &vec, int rows, int cols) {
+    if (rows < 0 || cols < 0 || matrix.size() != (size_t)rows * cols) {
+        throw invalid_argument("Matrix size does not match rows * cols.");
+    }
+    if (vec.size() != (size_t)cols) {
+        throw invalid_argument("Vector size does not match the number of matrix columns.");
+    }
+
+    uint32_t biasCorrection = int8BiasCorrection(vec.data(), cols);
+    vector<int> output(rows);
+    for (int row = 0; row < rows; row++) {
+        output[row] = dotInt8Kernel(matrix.data() + (size_t)row * cols, vec.data(), cols, biasCorrection);
+    }
+    return output;
+}
+
+vector<int> gemvInt16(const vector<int16_t> &matrix, const vector<int16_t> &vec, int rows, int cols) {
+    if (rows < 0 || cols < 0 || matrix.size() != (size_t)rows * cols) {
+        throw invalid_argument("Matrix size does not match rows * cols.");
+    }
+    if (vec.size() != (size_t)cols) {
+        throw invalid_argument("Vector size does not match the number of matrix columns.");
+    }
+
+    vector<int> output(rows);
+    for (int row = 0; row < rows; row++) {
+        output[row] = dotInt16Kernel(matrix.data() + (size_t)row * cols, vec.data(), cols);
+    }
+    return output;
+}
+
+// Divides by scale, clamps to [low, high] and rounds to nearest even. The clamp
+// happens in float before the conversion so every path agrees on out of range
+// and NaN inputs (NaN goes to low).
+static void quantizeBuffer(const vector<float> &values, float scale, float low, float high, int *output) {
+    int count = values.size();
+    int i = 0;
+
+    #if defined(__AVX512F__)
+    if (__builtin_cpu_supports("avx512f")) {
+        const __m512 scaleReg = _mm512_set1_ps(scale);
+        const __m512 lowReg = _mm512_set1_ps(low);
+        const __m512 highReg = _mm512_set1_ps(high);
+        for (; i + 16 <= count; i += 16) {
+            __m512 v = _mm512_div_ps(_mm512_loadu_ps(values.data() + i), scaleReg);
+            v = _mm512_min_ps(_mm512_max_ps(v, lowReg), highReg);
+            _mm512_storeu_si512((__m512i*)(output + i), _mm512_cvtps_epi32(v));
+        }
+    }
+    #endif
+
+    #if defined(__AVX__)
+    if (__builtin_cpu_supports("avx")) {
+        const __m256 scaleReg = _mm256_set1_ps(scale);
+        const __m256 lowReg = _mm256_set1_ps(low);
+        const __m256 highReg = _mm256_set1_ps(high);
+        for (; i + 8 <= count; i += 8) {
+            __m256 v = _mm256_div_ps(_mm256_loadu_ps(values.data() + i), scaleReg);
+            v = _mm256_min_ps(_mm256_max_ps(v, lowReg), highReg);
+            _mm256_storeu_si256((__m256i*)(output + i), _mm256_cvtps_epi32(v));
+        }
+    }
+    #endif
+
+    #if defined(__SSE2__)
+    if (__builtin_cpu_supports("sse2")) {
+        const __m128 scaleReg = _mm_set1_ps(scale);
+        const __m128 lowReg = _mm_set1_ps(low);
+        const __m128 highReg = _mm_set1_ps(high);
+        for (; i + 4 <= count; i += 4) {
+            __m128 v = _mm_div_ps(_mm_loadu_ps(values.data() + i), scaleReg);
+            v = _mm_min_ps(_mm_max_ps(v, lowReg), highReg);
+            _mm_storeu_si128((__m128i*)(output + i), _mm_cvtps_epi32(v));
+        }
+    }
+    #endif
+
+    for (; i < count; i++) {
+        // mirrors max_ps / min_ps operand order, including for NaN.
+        float v = values[i] / scale;
+        v = (v > low) ? v : low;
+        v = (v < high) ? v : high;
+        output[i] = (int)lrintf(v);
+    }
+}
+
+vector<int8_t> quantizeInt8(const vectorRegister<float> &floatReg, float scale) {
+    if (!(scale > 0.0f)) {
+        throw invalid_argument("Quantization scale must be positive.");
+    }
+
+    vector<float> values = floatReg.dumpRegister();
+    int count = values.size();
+    vector<int> buffer(count);
+    quantizeBuffer(values, scale, -128.0f, 127.0f, buffer.data());
+
+    vector<int8_t> output(count);
+    for (int i = 0; i < count; i++) {
+        output[i] = buffer[i];
+    }
+    return output;
+}
+
+vector<int16_t> quantizeInt16(const vectorRegister<float> &floatReg, float scale) {
+    if (!(scale > 0.0f)) {
+        throw invalid_argument("Quantization scale must be positive.");
+    }
+
+    vector<float> values = floatReg.dumpRegister();
+    int count = values.size();
+    vector<int> buffer(count);
+    quantizeBuffer(values, scale, -32768.0f, 32767.0f, buffer.data());
+
+    vector<int16_t> output(count);
+    for (int i = 0; i < count; i++) {
+        output[i] = buffer[i];
+    }
+    return output;
+}
+
+void dequantizeInt8(const vector<int8_t> &quantized, float scale, vectorRegister<float> &floatReg) {
+    int count = quantized.size();
+    vector<float> values(count);
+    for (int i = 0; i < count; i++) {
+        values[i] = quantized[i] * scale;
+    }
+    floatReg.loadRegister(values);
+}
+
+void dequantizeInt16(const vector<int16_t> &quantized, float scale, vectorRegister<float> &floatReg) {
+    int count = quantized.size();
+    vector<float> values(count);
+    for (int i = 0; i < count; i++) {
+        values[i] = quantized[i] * scale;
+    }
+    floatReg.loadRegister(values);
+}
+
+
+// out[i] = op(a[i], b[i], out[i]) for count lanes. With broadcastB, b[0] is
+// used for every lane.
+template <char op>
+static void batchLanes(const float *a, const float *b, bool broadcastB, float *out, int count) {
+    const bool accumulate = (op == 'a' || op == 's');
+    int i = 0;
+
+    #if defined(__AVX512F__)
+    if (__builtin_cpu_supports("avx512f")) {
+        __m512 bReg = broadcastB ? _mm512_set1_ps(*b) : _mm512_setzero_ps();
+        __m512 cReg = _mm512_setzero_ps();
+        for (; i + 16 <= count; i += 16) {
+            if (!broadcastB) { bReg = _mm512_loadu_ps(b + i); }
+            if (accumulate) { cReg = _mm512_loadu_ps(out + i); }
+            _mm512_storeu_ps(out + i, laneStep<op>(_mm512_loadu_ps(a + i), bReg, cReg));
+        }
+    }
+    #endif
+
+    #if defined(__AVX__)
+    if (__builtin_cpu_supports("avx")) {
+        __m256 bReg = broadcastB ? _mm256_set1_ps(*b) : _mm256_setzero_ps();
+        __m256 cReg = _mm256_setzero_ps();
+        for (; i + 8 <= count; i += 8) {
+            if (!broadcastB) { bReg = _mm256_loadu_ps(b + i); }
+            if (accumulate) { cReg = _mm256_loadu_ps(out + i); }
+            _mm256_storeu_ps(out + i, laneStep<op>(_mm256_loadu_ps(a + i), bReg, cReg));
+        }
+    }
+    #endif
+
+    #if defined(__SSE__)
+    if (__builtin_cpu_supports("sse")) {
+        __m128 bReg = broadcastB ? _mm_set1_ps(*b) : _mm_setzero_ps();
+        __m128 cReg = _mm_setzero_ps();
+        for (; i + 4 <= count; i += 4) {
+            if (!broadcastB) { bReg = _mm_loadu_ps(b + i); }
+            if (accumulate) { cReg = _mm_loadu_ps(out + i); }
+            _mm_storeu_ps(out + i, laneStep<op>(_mm_loadu_ps(a + i), bReg, cReg));
+        }
+    }
+    #endif
+
+    for (; i < count; i++) {
+        out[i] = laneStep<op>(a[i], broadcastB ? *b : b[i], out[i]);
+    }
+}
+
+template <char op>
+static void batchLanes(const double *a, const double *b, bool broadcastB, double *out, int count) {
+    const bool accumulate = (op == 'a' || op == 's');
+    int i = 0;
+
+    #if defined(__AVX512F__)
+    if (__builtin_cpu_supports("avx512f")) {
+        __m512d bReg = broadcastB ? _mm512_set1_pd(*b) : _mm512_setzero_pd();
+        __m512d cReg = _mm512_setzero_pd();
+        for (; i + 8 <= count; i += 8) {
+            if (!broadcastB) { bReg = _mm512_loadu_pd(b + i); }
+            if (accumulate) { cReg = _mm512_loadu_pd(out + i); }
+            _mm512_storeu_pd(out + i, laneStep<op>(_mm512_loadu_pd(a + i), bReg, cReg));
+        }
+    }
+    #endif
+
+    #if defined(__AVX__)
+    if (__builtin_cpu_supports("avx")) {
+        __m256d bReg = broadcastB ? _mm256_set1_pd(*b) : _mm256_setzero_pd();
+        __m256d cReg = _mm256_setzero_pd();
+        for (; i + 4 <= count; i += 4) {
+            if (!broadcastB) { bReg = _mm256_loadu_pd(b + i); }
+            if (accumulate) { cReg = _mm256_loadu_pd(out + i); }
+            _mm256_storeu_pd(out + i, laneStep<op>(_mm256_loadu_pd(a + i), bReg, cReg));
+        }
+    }
+    #endif
+
+    #if defined(__SSE2__)
+    if (__builtin_cpu_supports("sse2")) {
+        __m128d bReg = broadcastB ? _mm_set1_pd(*b) : _mm_setzero_pd();
+        __m128d cReg = _mm_setzero_pd();
+        for (; i + 2 <= count; i += 2) {
+            if (!broadcastB) { bReg = _mm_loadu_pd(b + i); }
+            if (accumulate) { cReg = _mm_loadu_pd(out + i); }
+            _mm_storeu_pd(out + i, laneStep<op>(_mm_loadu_pd(a + i), bReg, cReg));
+        }
+    }
+    #endif
+
+    for (; i < count; i++) {
+        out[i] = laneStep<op>(a[i], broadcastB ? *b : b[i], out[i]);
+    }
+}
+
+template <char op>
+static void batchLanes(const int *a, const int *b, bool broadcastB, int *out, int count) {
+    const bool accumulate = (op == 'a' || op == 's');
+    int i = 0;
+
+    #if defined(__AVX512F__)
+    if (__builtin_cpu_supports("avx512f")) {
+        __m512i bReg = broadcastB ? _mm512_set1_epi32(*b) : _mm512_setzero_si512();
+        __m512i cReg = _mm512_setzero_si512();
+        for (; i + 16 <= count; i += 16) {
+            if (!broadcastB) { bReg = _mm512_loadu_si512((const void*)(b + i)); }
+            if (accumulate) { cReg = _mm512_loadu_si512((const void*)(out + i)); }
+            _mm512_storeu_si512((void*)(out + i), laneStep<op>(_mm512_loadu_si512((const void*)(a + i)), bReg, cReg));
+        }
+    }
+    #endif
+
+    #if defined(__AVX2__)
+    if (__builtin_cpu_supports("avx2")) {
+        __m256i bReg = broadcastB ? _mm256_set1_epi32(*b) : _mm256_setzero_si256();
+        __m256i cReg = _mm256_setzero_si256();
+        for (; i + 8 <= count; i += 8) {
+            if (!broadcastB) { bReg = _mm256_loadu_si256((const __m256i*)(b + i)); }
+            if (accumulate) { cReg = _mm256_loadu_si256((const __m256i*)(out + i)); }
+            _mm256_storeu_si256((__m256i*)(out + i), laneStep<op>(_mm256_loadu_si256((const __m256i*)(a + i)), bReg, cReg));
+        }
+    }
+    #endif
+
+    #if defined(__SSE2__)
+    if (__builtin_cpu_supports("sse2")) {
+        __m128i bReg = broadcastB ? _mm_set1_epi32(*b) : _mm_setzero_si128();
+        __m128i cReg = _mm_setzero_si128();
+        for (; i + 4 <= count; i += 4) {
+            if (!broadcastB) { bReg = _mm_loadu_si128((const __m128i*)(b + i)); }
+            if (accumulate) { cReg = _mm_loadu_si128((const __m128i*)(out + i)); }
+            _mm_storeu_si128((__m128i*)(out + i), laneStep<op>(_mm_loadu_si128((const __m128i*)(a + i)), bReg, cReg));
+        }
+    }
+    #endif
+
+    for (; i < count; i++) {
+        out[i] = laneStep<op>(a[i], broadcastB ? *b : b[i], out[i]);
+    }
+}
+
+// Fused vectorBatch kernels. Each works one register of lanes at a time : every
+// input component is loaded once, all output components are computed in
+// registers, and each output row is stored once. Rows are stride lanes apart.
+struct batchDot {
+    template <typename T, typename Lane>
+    static int run(const T *lhs, const T *rhs, T *out, int stride, int dimension, int i, int count) {
+        typedef typename Lane::reg reg;
+        const int width = sizeof(reg) / sizeof(T);
+        for (; i + width <= count; i += width) {
+            reg acc = laneStep<'*'>(Lane::load(lhs + i), Lane::load(rhs + i), Lane::zero());
+            for (int c = 1; c < dimension; c++) {
+                acc = laneStep<'a'>(Lane::load(lhs + c * stride + i), Lane::load(rhs + c * stride + i), acc);
+            }
+            Lane::store(out + i, acc);
+        }
+        return i;
+    }
+};
+
+struct batchCross {
+    template <typename T, typename Lane>
+    static int run(const T *lhs, const T *rhs, T *out, int stride, int, int i, int count) {
+        typedef typename Lane::reg reg;
+        const int width = sizeof(reg) / sizeof(T);
+        for (; i + width <= count; i += width) {
+            reg ax = Lane::load(lhs + i), ay = Lane::load(lhs + stride + i), az = Lane::load(lhs + 2 * stride + i);
+            reg bx = Lane::load(rhs + i), by = Lane::load(rhs + stride + i), bz = Lane::load(rhs + 2 * stride + i);
+            reg zero = Lane::zero();
+            Lane::store(out + i, laneStep<'s'>(az, by, laneStep<'*'>(ay, bz, zero)));
+            Lane::store(out + stride + i, laneStep<'s'>(ax, bz, laneStep<'*'>(az, bx, zero)));
+            Lane::store(out + 2 * stride + i, laneStep<'s'>(ay, bx, laneStep<'*'>(ax, by, zero)));
+        }
+        return i;
+    }
+};
+
+// Hamilton product with components ordered (w, x, y, z).
+struct batchQuaternion {
+    template <typename T, typename Lane>
+    static int run(const T *lhs, const T *rhs, T *out, int stride, int, int i, int count) {
+        typedef typename Lane::reg reg;
+        const int width = sizeof(reg) / sizeof(T);
+        for (; i + width <= count; i += width) {
+            reg aw = Lane::load(lhs + i), ax = Lane::load(lhs + stride + i);
+            reg ay = Lane::load(lhs + 2 * stride + i), az = Lane::load(lhs + 3 * stride + i);
+            reg bw = Lane::load(rhs + i), bx = Lane::load(rhs + stride + i);
+            reg by = Lane::load(rhs + 2 * stride + i), bz = Lane::load(rhs + 3 * stride + i);
+            reg zero = Lane::zero();
+
+            reg w = laneStep<'*'>(aw, bw, zero);
+            w = laneStep<'s'>(ax, bx, w);
+            w = laneStep<'s'>(ay, by, w);
+            w = laneStep<'s'>(az, bz, w);
+
+            reg x = laneStep<'*'>(aw, bx, zero);
+            x = laneStep<'a'>(ax, bw, x);
+            x = laneStep<'a'>(ay, bz, x);
+            x = laneStep<'s'>(az, by, x);
+
+            reg y = laneStep<'*'>(aw, by, zero);
+            y = laneStep<'s'>(ax, bz, y);
+            y = laneStep<'a'>(ay, bw, y);
+            y = laneStep<'a'>(az, bx, y);
+
+            reg z = laneStep<'*'>(aw, bz, zero);
+            z = laneStep<'a'>(ax, by, z);
+            z = laneStep<'s'>(ay, bx, z);
+            z = laneStep<'a'>(az, bw, z);
+
+            Lane::store(out + i, w);
+            Lane::store(out + stride + i, x);
+            Lane::store(out + 2 * stride + i, y);
+            Lane::store(out + 3 * stride + i, z);
+        }
+        return i;
+    }
+};
+
+template <typename Kernel>
+static void fusedLanes(const float *lhs, const float *rhs, float *out, int stride, int dimension, int count) {
+    int i = 0;
+
+    #if defined(__AVX512F__)
+    if (__builtin_cpu_supports("avx512f")) {
+        i = Kernel::template run<float, laneRegister<float, 16> >(lhs, rhs, out, stride, dimension, i, count);
+    }
+    #endif
+
+    #if defined(__AVX__)
+    if (__builtin_cpu_supports("avx")) {
+        i = Kernel::template run<float, laneRegister<float, 8> >(lhs, rhs, out, stride, dimension, i, count);
+    }
+    #endif
+
+    #if defined(__SSE2__)
+    if (__builtin_cpu_supports("sse2")) {
+        i = Kernel::template run<float, laneRegister<float, 4> >(lhs, rhs, out, stride, dimension, i, count);
+    }
+    #endif
+
+    Kernel::template run<float, scalarLane<float> >(lhs, rhs, out, stride, dimension, i, count);
+}
+
+template <typename Kernel>
+static void fusedLanes(const double *lhs, const double *rhs, double *out, int stride, int dimension, int count) {
+    int i = 0;
+
+    #if defined(__AVX512F__)
+    if (__builtin_cpu_supports("avx512f")) {
+        i = Kernel::template run<double, laneRegister<double, 8> >(lhs, rhs, out, stride, dimension, i, count);
+    }
+    #endif
+
+    #if defined(__AVX__)
+    if (__builtin_cpu_supports("avx")) {
+        i = Kernel::template run<double, laneRegister<double, 4> >(lhs, rhs, out, stride, dimension, i, count);
+    }
+    #endif
+
+    #if defined(__SSE2__)
+    if (__builtin_cpu_supports("sse2")) {
+        i = Kernel::template run<double, laneRegister<double, 2> >(lhs, rhs, out, stride, dimension, i, count);
+    }
+    #endif
+
+    Kernel::template run<double, scalarLane<double> >(lhs, rhs, out, stride, dimension, i, count);
+}
+
+template <typename Kernel>
+static void fusedLanes(const int *lhs, const int *rhs, int *out, int stride, int dimension, int count) {
+    int i = 0;
+
+    #if defined(__AVX512F__)
+    if (__builtin_cpu_supports("avx512f")) {
+        i = Kernel::template run<int, laneRegister<int, 16> >(lhs, rhs, out, stride, dimension, i, count);
+    }
+    #endif
+
+    #if defined(__AVX2__)
+    if (__builtin_cpu_supports("avx2")) {
+        i = Kernel::template run<int, laneRegister<int, 8> >(lhs, rhs, out, stride, dimension, i, count);
+    }
+    #endif
+
+    #if defined(__SSE2__)
+    if (__builtin_cpu_supports("sse2")) {
+        i = Kernel::template run<int, laneRegister<int, 4> >(lhs, rhs, out, stride, dimension, i, count);
+    }
+    #endif
+
+    Kernel::template run<int, scalarLane<int> >(lhs, rhs, out, stride, dimension, i, count);
+}
+
+template <typename T>
+vectorBatch<T>::vectorBatch(int dimension) {
+    if (dimension <= 0) {
+        throw invalid_argument("Vector batches need a dimension of at least 1.");
+    }
+
+    // the probe register validates T and picks the lane count for this CPU.
+    vectorRegister<T> probe;
+    registerSize = probe.getRegisterSize();
+    type = probe.getType();
+
+    this->dimension = dimension;
+    batchSize = 0;
+    paddedSize = 0;
+};
+
+template <typename T>
+int vectorBatch<T>::getDimension() const {
+    return dimension;
+};
+
+template <typename T>
+int vectorBatch<T>::getBatchSize() const {
+    return batchSize;
+};
+
+template <typename T>
+int vectorBatch<T>::getRegisterSize() const {
+    return registerSize;
+};
+
+template <typename T>
+char vectorBatch<T>::getType() const {
+    return type;
+};
+
+template <typename T>
+void vectorBatch<T>::resizeBatch(int newBatchSize) {
+    batchSize = newBatchSize;
+    paddedSize = ((newBatchSize + registerSize - 1) / registerSize) * registerSize;
+    lanes.assign((size_t)dimension * paddedSize, 0);
+}
+
+template <typename T>
+void vectorBatch<T>::checkCompatible(const vectorBatch<T>& rhs) const {
+    if (dimension != rhs.dimension) {
+        throw invalid_argument("You cannot combine vector batches of different dimensions.");
+    }
+    if (batchSize != rhs.batchSize) {
+        throw invalid_argument("You cannot combine vector batches of different sizes.");
+    }
+}
+
+template <typename T>
+T *vectorBatch<T>::componentRow(int component) {
+    return lanes.data() + (size_t)component * paddedSize;
+}
+
+template <typename T>
+const T *vectorBatch<T>::componentRow(int component) const {
+    return lanes.data() + (size_t)component * paddedSize;
+}
+
+template <typename T>
+void vectorBatch<T>::packVectors(const vector<vector<T>> &vectorsToPack) {
+    int vectorCount = vectorsToPack.size();
+
+    // validate everything first so a throw leaves the batch untouched.
+    for (int v = 0; v < vectorCount; v++) {
+        if (vectorsToPack[v].size() > (size_t)dimension) {
+            throw invalid_argument("Size was too large of a vector to pack into this batch.");
+        }
+    }
+
+    resizeBatch(vectorCount);
+
+    for (int v = 0; v < batchSize; v++) {
+        // shorter vectors are padded with zeros, like loadRegister.
+        int components = vectorsToPack[v].size();
+        for (int c = 0; c < components; c++) {
+            componentRow(c)[v] = vectorsToPack[v][c];
+        }
+    }
+}
+
+template <typename T>
+vector<vector<T>> vectorBatch<T>::unpackVectors() const {
+    vector<vector<T>> unpacked(batchSize, vector<T>(dimension));
+    for (int c = 0; c < dimension; c++) {
+        const T *row = componentRow(c);
+        for (int v = 0; v < batchSize; v++) {
+            unpacked[v][c] = row[v];
+        }
+    }
+    return unpacked;
+}
+
+template <typename T>
+vectorBatch<T> vectorBatch<T>::operator+(const vectorBatch<T>& rhs) const {
+    checkCompatible(rhs);
+    vectorBatch<T> solutionBatch(dimension);
+    solutionBatch.resizeBatch(batchSize);
+    batchLanes<'+'>(lanes.data(), rhs.lanes.data(), false, solutionBatch.lanes.data(), lanes.size());
+    return solutionBatch;
+}
+
+template <typename T>
+vectorBatch<T> vectorBatch<T>::operator-(const vectorBatch<T>& rhs) const {
+    checkCompatible(rhs);
+    vectorBatch<T> solutionBatch(dimension);
+    solutionBatch.resizeBatch(batchSize);
+    batchLanes<'-'>(lanes.data(), rhs.lanes.data(), false, solutionBatch.lanes.data(), lanes.size());
+    return solutionBatch;
+}
+
+template <typename T>
+vectorBatch<T> vectorBatch<T>::operator*(const vectorBatch<T>& rhs) const {
+    checkCompatible(rhs);
+    vectorBatch<T> solutionBatch(dimension);
+    solutionBatch.resizeBatch(batchSize);
+    batchLanes<'*'>(lanes.data(), rhs.lanes.data(), false, solutionBatch.lanes.data(), lanes.size());
+    return solutionBatch;
+}
+
+template <typename T>
+vectorBatch<T> vectorBatch<T>::operator*(T factor) const {
+    vectorBatch<T> solutionBatch(dimension);
+    solutionBatch.resizeBatch(batchSize);
+    batchLanes<'*'>(lanes.data(), &factor, true, solutionBatch.lanes.data(), lanes.size());
+    return solutionBatch;
+}
+
+template <typename T>
+vector<T> vectorBatch<T>::dot(const vectorBatch<T>& rhs) const {
+    checkCompatible(rhs);
+    vector<T> buffer(paddedSize);
+    fusedLanes<batchDot>(lanes.data(), rhs.lanes.data(), buffer.data(), paddedSize, dimension, paddedSize);
+    buffer.resize(batchSize);
+    return buffer;
+}
+
+template <typename T>
+vectorBatch<T> vectorBatch<T>::cross(const vectorBatch<T>& rhs) const {
+    checkCompatible(rhs);
+    if (dimension != 3) {
+        throw invalid_argument("The cross product is only defined for batches of dimension 3.");
+    }
+
+    vectorBatch<T> solutionBatch(dimension);
+    solutionBatch.resizeBatch(batchSize);
+    fusedLanes<batchCross>(lanes.data(), rhs.lanes.data(), solutionBatch.lanes.data(), paddedSize, dimension, paddedSize);
+    return solutionBatch;
+}
+
+template <typename T>
+vectorBatch<T> vectorBatch<T>::quaternionMultiply(const vectorBatch<T>& rhs) const {
+    checkCompatible(rhs);
+    if (dimension != 4) {
+        throw invalid_argument("Quaternion multiplication is only defined for batches of dimension 4.");
+    }
+
+    vectorBatch<T> solutionBatch(dimension);
+    solutionBatch.resizeBatch(batchSize);
+    fusedLanes<batchQuaternion>(lanes.data(), rhs.lanes.data(), solutionBatch.lanes.data(), paddedSize, dimension, paddedSize);
+    return solutionBatch;
+}
+
+template class vectorBatch<int>;
+template class vectorBatch<float>;
+template class vectorBatch<double>;
+
+
+// Taps per pass of the FIR kernel. Longer filters are split into blocks of
+// taps that accumulate into the output, so the taps and input window of one
+// pass stay in L1.
+static const int firTapBlock = 512;
+
+// output[i] (+)= sum_j reversedTaps[j] * input[i + j]. Each tap is broadcast
+// once and multiplied into overlapping unaligned loads of the input, four
+// registers of outputs at a time.
+template <typename T, int width>
+static int firLanes(const T *input, const T *reversedTaps, int tapCount, T *output, int i, int outputCount, bool accumulate) {
+    typedef laneRegister<T, width> lane;
+    typedef typename lane::reg reg;
+
+    for (; i + 4 * width <= outputCount; i += 4 * width) {
+        reg acc0 = accumulate ? lane::load(output + i) : lane::zero();
+        reg acc1 = accumulate ? lane::load(output + i + width) : lane::zero();
+        reg acc2 = accumulate ? lane::load(output + i + 2 * width) : lane::zero();
+        reg acc3 = accumulate ? lane::load(output + i + 3 * width) : lane::zero();
+        for (int j = 0; j < tapCount; j++) {
+            reg tap = lane::broadcast(reversedTaps[j]);
+            const T *window = input + i + j;
+            acc0 = laneStep<'a'>(tap, lane::load(window), acc0);
+            acc1 = laneStep<'a'>(tap, lane::load(window + width), acc1);
+            acc2 = laneStep<'a'>(tap, lane::load(window + 2 * width), acc2);
+            acc3 = laneStep<'a'>(tap, lane::load(window + 3 * width), acc3);
+        }
+        lane::store(output + i, acc0);
+        lane::store(output + i + width, acc1);
+        lane::store(output + i + 2 * width, acc2);
+        lane::store(output + i + 3 * width, acc3);
+    }
+
+    for (; i + width <= outputCount; i += width) {
+        reg acc = accumulate ? lane::load(output + i) : lane::zero();
+        for (int j = 0; j < tapCount; j++) {
+            acc = laneStep<'a'>(lane::broadcast(reversedTaps[j]), lane::load(input + i + j), acc);
+        }
+        lane::store(output + i, acc);
+    }
+    return i;
+}
+
+template <typename T>
+static void firPass(const T *input, const T *reversedTaps, int tapCount, T *output, int outputCount, bool accumulate) {
+    int i = 0;
+
+    #if defined(__AVX512F__)
+    if (__builtin_cpu_supports("avx512f")) {
+        i = firLanes<T, 64 / sizeof(T)>(input, reversedTaps, tapCount, output, i, outputCount, accumulate);
+    }
+    #endif
+
+    #if defined(__AVX__)
+    if (__builtin_cpu_supports("avx")) {
+        i = firLanes<T, 32 / sizeof(T)>(input, reversedTaps, tapCount, output, i, outputCount, accumulate);
+    }
+    #endif
+
+    #if defined(__SSE2__)
+    if (__builtin_cpu_supports("sse2")) {
+        i = firLanes<T, 16 / sizeof(T)>(input, reversedTaps, tapCount, output, i, outputCount, accumulate);
+    }
+    #endif
+
+    for (; i < outputCount; i++) {
+        T acc = accumulate ? output[i] : 0;
+        for (int j = 0; j < tapCount; j++) {
+            acc += reversedTaps[j] * input[i + j];
+        }
+        output[i] = acc;
+    }
+}
+
+// input holds outputCount + tapCount - 1 samples.
+template <typename T>
+static void firKernel(const T *input, const T *reversedTaps, int tapCount, T *output, int outputCount) {
+    for (int start = 0; start < tapCount; start += firTapBlock) {
+        int blockTaps = min(firTapBlock, tapCount - start);
+        firPass(input + start, reversedTaps + start, blockTaps, output, outputCount, start > 0);
+    }
+}
+
+template <typename T>
+vector<T> convolve(const vector<T> &signal, const vector<T> &taps) {
+    if (taps.empty()) {
+        throw invalid_argument("You cannot convolve with an empty set of taps.");
+    }
+    if (signal.empty()) {
+        return vector<T>(0);
+    }
+
+    int tapCount = taps.size();
+    int outputCount = signal.size() + tapCount - 1;
+
+    // zero padding on both sides gives the full convolution.
+    vector<T> padded(outputCount + tapCount - 1, 0);
+    copy(signal.begin(), signal.end(), padded.begin() + tapCount - 1);
+    vector<T> reversedTaps(taps.rbegin(), taps.rend());
+
+    vector<T> output(outputCount);
+    firKernel(padded.data(), reversedTaps.data(), tapCount, output.data(), outputCount);
+    return output;
+}
+
+template <typename T>
+firFilter<T>::firFilter(const vector<T> &taps) {
+    static_assert(is_same<T, float>::value || is_same<T, double>::value, "FIR filters can only be of Type : float or double.");
+    if (taps.empty()) {
+        throw invalid_argument("FIR filters need at least one tap.");
+    }
+
+    reversedTaps.assign(taps.rbegin(), taps.rend());
+    window.assign(taps.size() - 1, 0);
+};
+
+template <typename T>
+int firFilter<T>::getTapCount() const {
+    return reversedTaps.size();
+};
+
+template <typename T>
+void firFilter<T>::reset() {
+    window.assign(reversedTaps.size() - 1, 0);
+};
+
+template <typename T>
+vector<T> firFilter<T>::filterBlock(const vector<T> &block) {
+    if (block.empty()) {
+        return vector<T>(0);
+    }
+
+    int history = reversedTaps.size() - 1;
+    int blockSize = block.size();
+
+    window.resize(history + blockSize);
+    copy(block.begin(), block.end(), window.begin() + history);
+
+    vector<T> output(blockSize);
+    firKernel(window.data(), reversedTaps.data(), reversedTaps.size(), output.data(), blockSize);
+
+    // the overlap for the next block is the tail of this window.
+    copy(window.end() - history, window.end(), window.begin());
+    window.resize(history);
+    return output;
+};
+
+template vector<float> convolve(const vector<float> &signal, const vector<float> &taps);
+template vector<double> convolve(const vector<double> &signal, const vector<double> &taps);
+template class firFilter<float>;
+template class firFilter<double>;
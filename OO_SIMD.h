@@ -1,10 +1,13 @@
 #include <immintrin.h>
+#include <cstdint>
 #include <typeinfo>
 #include <stdexcept>
 #include <vector>
 #include <ostream>
 #include <iostream>
 
+#include "OO_SIMD_detail.h"
+
 using namespace std;
 
 template <typename T>
@@ -56,6 +59,44 @@ class vectorRegister {
         char type;
 };
 
+// Packs many short vectors (coordinates, quaternions, ...) across register lanes
+// in transposed layout : component c of vector v is stored in lane v of row c,
+// so every register operation works on registerSize vectors at once instead of
+// padding one short vector out to a full register.
+template <typename T>
+class vectorBatch {
+    public:
+        vectorBatch(int dimension);
+        int getDimension() const;
+        int getBatchSize() const;
+        int getRegisterSize() const;
+        char getType() const;
+        void packVectors(const vector<vector<T>> &vectorsToPack);
+        vector<vector<T>> unpackVectors() const;
+
+        vectorBatch<T> operator+(const vectorBatch<T>& rhs) const;
+        vectorBatch<T> operator-(const vectorBatch<T>& rhs) const;
+        vectorBatch<T> operator*(const vectorBatch<T>& rhs) const;
+        vectorBatch<T> operator*(T factor) const;
+        vector<T> dot(const vectorBatch<T>& rhs) const;
+        vectorBatch<T> cross(const vectorBatch<T>& rhs) const;
+        vectorBatch<T> quaternionMultiply(const vectorBatch<T>& rhs) const;
+
+    private:
+        void resizeBatch(int newBatchSize);
+        void checkCompatible(const vectorBatch<T>& rhs) const;
+        T *componentRow(int component);
+        const T *componentRow(int component) const;
+
+        // dimension rows of paddedSize lanes, paddedSize a multiple of registerSize.
+        vector<T> lanes;
+        int dimension;
+        int batchSize;
+        int paddedSize;
+        int registerSize;
+        char type;
+};
+
 template <typename T>
 ostream& operator<<(ostream& out, const vectorRegister<T> &vecReg) {
     vector<T> vecDump = vecReg.dumpRegister();
@@ -67,5 +108,130 @@ ostream& operator<<(ostream& out, const vectorRegister<T> &vecReg) {
     return out;
 }
 
+// Quantized integer kernels. Products are accumulated into 32-bit integers that
+// wrap modulo 2^32 on overflow, and every SIMD path (AVX512 VNNI, AVX2, SSE2)
+// returns the same result as the scalar fallback.
+int dotProductInt8(const vector<int8_t> &lhs, const vector<int8_t> &rhs);
+int dotProductInt16(const vector<int16_t> &lhs, const vector<int16_t> &rhs);
+
+// matrix is row-major with rows * cols entries, vec has cols entries.
+vector<int> gemvInt8(const vector<int8_t> &matrix, const vector<int8_t> &vec, int rows, int cols);
+vector<int> gemvInt16(const vector<int16_t> &matrix, const vector<int16_t> &vec, int rows, int cols);
+
+// Symmetric quantization : q = clamp(round(x / scale)), x = q * scale.
+vector<int8_t> quantizeInt8(const vectorRegister<float> &floatReg, float scale);
+vector<int16_t> quantizeInt16(const vectorRegister<float> &floatReg, float scale);
+void dequantizeInt8(const vector<int8_t> &quantized, float scale, vectorRegister<float> &floatReg);
+void dequantizeInt16(const vector<int16_t> &quantized, float scale, vectorRegister<float> &floatReg);
+
+// Full linear convolution of signal with taps (signal.size() + taps.size() - 1
+// outputs), for float and double.
+template <typename T>
+vector<T> convolve(const vector<T> &signal, const vector<T> &taps);
+
+// Streaming FIR filter, y[n] = sum_k taps[k] * x[n - k], for float and double.
+// Blocks are filtered overlap-save style : the last taps.size() - 1 inputs are
+// kept between calls so consecutive blocks filter as one continuous signal.
+template <typename T>
+class firFilter {
+    public:
+        firFilter(const vector<T> &taps);
+        int getTapCount() const;
+        vector<T> filterBlock(const vector<T> &block);
+        void reset();
+
+    private:
+        vector<T> reversedTaps;
+        // taps.size() - 1 samples of history followed by the current block.
+        vector<T> window;
+};
+
+// Evaluates c[0] + c[1] x + ... + c[N - 1] x^(N - 1) with Horner's rule. The
+// coefficient chain is unrolled at compile time.
+template <typename T, int N>
+class hornerPolynomial {
+    public:
+        hornerPolynomial(const T (&coefficients)[N]);
+        vector<T> evaluate(const vector<T> &x) const;
+
+    private:
+        template <int width>
+        int evaluateLanes(const T *x, T *output, int i, int count) const;
+
+        T coefficients[N];
+};
+
+template <typename T, int N>
+hornerPolynomial<T, N>::hornerPolynomial(const T (&coefficients)[N]) {
+    static_assert(is_same<T, float>::value || is_same<T, double>::value, "Polynomials can only be of Type : float or double.");
+    static_assert(N > 0, "Polynomials need at least one coefficient.");
+    for (int k = 0; k < N; k++) {
+        this->coefficients[k] = coefficients[k];
+    }
+}
+
+template <typename T, int N>
+template <int width>
+int hornerPolynomial<T, N>::evaluateLanes(const T *x, T *output, int i, int count) const {
+    typedef oo_simd_detail::laneRegister<T, width> lane;
+    typename lane::reg c[N];
+    for (int k = 0; k < N; k++) {
+        c[k] = lane::broadcast(coefficients[k]);
+    }
 
+    // four independent chains per iteration to hide the FMA latency. All loads
+    // come before any store, since output may alias x and the compiler would
+    // otherwise have to run the chains one after another.
+    for (; i + 4 * width <= count; i += 4 * width) {
+        typename lane::reg x0 = lane::load(x + i);
+        typename lane::reg x1 = lane::load(x + i + width);
+        typename lane::reg x2 = lane::load(x + i + 2 * width);
+        typename lane::reg x3 = lane::load(x + i + 3 * width);
+        typename lane::reg y0 = oo_simd_detail::hornerUnroll<N - 1>::step(c, x0, c[N - 1]);
+        typename lane::reg y1 = oo_simd_detail::hornerUnroll<N - 1>::step(c, x1, c[N - 1]);
+        typename lane::reg y2 = oo_simd_detail::hornerUnroll<N - 1>::step(c, x2, c[N - 1]);
+        typename lane::reg y3 = oo_simd_detail::hornerUnroll<N - 1>::step(c, x3, c[N - 1]);
+        lane::store(output + i, y0);
+        lane::store(output + i + width, y1);
+        lane::store(output + i + 2 * width, y2);
+        lane::store(output + i + 3 * width, y3);
+    }
+    for (; i + width <= count; i += width) {
+        lane::store(output + i, oo_simd_detail::hornerUnroll<N - 1>::step(c, lane::load(x + i), c[N - 1]));
+    }
+    return i;
+}
+
+template <typename T, int N>
+vector<T> hornerPolynomial<T, N>::evaluate(const vector<T> &x) const {
+    int count = x.size();
+    vector<T> output(count);
+    int i = 0;
 
+    #if defined(__AVX512F__)
+    if (__builtin_cpu_supports("avx512f")) {
+        i = evaluateLanes<64 / sizeof(T)>(x.data(), output.data(), i, count);
+    }
+    #endif
+
+    #if defined(__AVX__)
+    if (__builtin_cpu_supports("avx")) {
+        i = evaluateLanes<32 / sizeof(T)>(x.data(), output.data(), i, count);
+    }
+    #endif
+
+    #if defined(__SSE2__)
+    if (__builtin_cpu_supports("sse2")) {
+        i = evaluateLanes<16 / sizeof(T)>(x.data(), output.data(), i, count);
+    }
+    #endif
+
+    for (; i < count; i++) {
+        T acc = coefficients[N - 1];
+        for (int k = N - 2; k >= 0; k--) {
+            acc = acc * x[i] + coefficients[k];
+        }
+        output[i] = acc;
+    }
+    return output;
+}
@@ -0,0 +1,316 @@
+// Internal helpers for the array kernels in OO_SIMD.cpp and the templated
+// kernels in OO_SIMD.h. Not part of the public interface.
+#ifndef OO_SIMD_DETAIL_H
+#define OO_SIMD_DETAIL_H
+
+#include <immintrin.h>
+
+namespace oo_simd_detail {
+
+    // 32-bit low multiply; SSE2 has no mullo_epi32 before SSE4.1.
+#if defined(__SSE2__)
+    inline __m128i mulloEpi32(__m128i a, __m128i b) {
+        #if defined(__SSE4_1__)
+            return _mm_mullo_epi32(a, b);
+        #else
+            __m128i even = _mm_mul_epu32(a, b);
+            __m128i odd = _mm_mul_epu32(_mm_srli_epi64(a, 32), _mm_srli_epi64(b, 32));
+            return _mm_unpacklo_epi32(_mm_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 2, 0)),
+                                      _mm_shuffle_epi32(odd, _MM_SHUFFLE(0, 0, 2, 0)));
+        #endif
+    }
+#endif
+
+#if defined(__SSE__)
+    // Register level step shared by the array kernels. op is fixed at compile time :
+    // '+', '-', '*' : a op b
+    // 'a' : c + a * b
+    // 's' : c - a * b
+    template <char op>
+    inline __m128 laneStep(__m128 a, __m128 b, __m128 c) {
+        switch(op) {
+            case '+': return _mm_add_ps(a, b);
+            case '-': return _mm_sub_ps(a, b);
+            case '*': return _mm_mul_ps(a, b);
+            #if defined(__FMA__)
+            case 'a': return _mm_fmadd_ps(a, b, c);
+            case 's': return _mm_fnmadd_ps(a, b, c);
+            #else
+            case 'a': return _mm_add_ps(c, _mm_mul_ps(a, b));
+            case 's': return _mm_sub_ps(c, _mm_mul_ps(a, b));
+            #endif
+        }
+        return c;
+    }
+#endif
+
+#if defined(__SSE2__)
+    template <char op>
+    inline __m128d laneStep(__m128d a, __m128d b, __m128d c) {
+        switch(op) {
+            case '+': return _mm_add_pd(a, b);
+            case '-': return _mm_sub_pd(a, b);
+            case '*': return _mm_mul_pd(a, b);
+            #if defined(__FMA__)
+            case 'a': return _mm_fmadd_pd(a, b, c);
+            case 's': return _mm_fnmadd_pd(a, b, c);
+            #else
+            case 'a': return _mm_add_pd(c, _mm_mul_pd(a, b));
+            case 's': return _mm_sub_pd(c, _mm_mul_pd(a, b));
+            #endif
+        }
+        return c;
+    }
+
+    template <char op>
+    inline __m128i laneStep(__m128i a, __m128i b, __m128i c) {
+        switch(op) {
+            case '+': return _mm_add_epi32(a, b);
+            case '-': return _mm_sub_epi32(a, b);
+            case '*': return mulloEpi32(a, b);
+            case 'a': return _mm_add_epi32(c, mulloEpi32(a, b));
+            case 's': return _mm_sub_epi32(c, mulloEpi32(a, b));
+        }
+        return c;
+    }
+#endif
+
+#if defined(__AVX__)
+    template <char op>
+    inline __m256 laneStep(__m256 a, __m256 b, __m256 c) {
+        switch(op) {
+            case '+': return _mm256_add_ps(a, b);
+            case '-': return _mm256_sub_ps(a, b);
+            case '*': return _mm256_mul_ps(a, b);
+            #if defined(__FMA__)
+            case 'a': return _mm256_fmadd_ps(a, b, c);
+            case 's': return _mm256_fnmadd_ps(a, b, c);
+            #else
+            case 'a': return _mm256_add_ps(c, _mm256_mul_ps(a, b));
+            case 's': return _mm256_sub_ps(c, _mm256_mul_ps(a, b));
+            #endif
+        }
+        return c;
+    }
+
+    template <char op>
+    inline __m256d laneStep(__m256d a, __m256d b, __m256d c) {
+        switch(op) {
+            case '+': return _mm256_add_pd(a, b);
+            case '-': return _mm256_sub_pd(a, b);
+            case '*': return _mm256_mul_pd(a, b);
+            #if defined(__FMA__)
+            case 'a': return _mm256_fmadd_pd(a, b, c);
+            case 's': return _mm256_fnmadd_pd(a, b, c);
+            #else
+            case 'a': return _mm256_add_pd(c, _mm256_mul_pd(a, b));
+            case 's': return _mm256_sub_pd(c, _mm256_mul_pd(a, b));
+            #endif
+        }
+        return c;
+    }
+#endif
+
+#if defined(__AVX2__)
+    template <char op>
+    inline __m256i laneStep(__m256i a, __m256i b, __m256i c) {
+        switch(op) {
+            case '+': return _mm256_add_epi32(a, b);
+            case '-': return _mm256_sub_epi32(a, b);
+            case '*': return _mm256_mullo_epi32(a, b);
+            case 'a': return _mm256_add_epi32(c, _mm256_mullo_epi32(a, b));
+            case 's': return _mm256_sub_epi32(c, _mm256_mullo_epi32(a, b));
+        }
+        return c;
+    }
+#endif
+
+#if defined(__AVX512F__)
+    template <char op>
+    inline __m512 laneStep(__m512 a, __m512 b, __m512 c) {
+        switch(op) {
+            case '+': return _mm512_add_ps(a, b);
+            case '-': return _mm512_sub_ps(a, b);
+            case '*': return _mm512_mul_ps(a, b);
+            case 'a': return _mm512_fmadd_ps(a, b, c);
+            case 's': return _mm512_fnmadd_ps(a, b, c);
+        }
+        return c;
+    }
+
+    template <char op>
+    inline __m512d laneStep(__m512d a, __m512d b, __m512d c) {
+        switch(op) {
+            case '+': return _mm512_add_pd(a, b);
+            case '-': return _mm512_sub_pd(a, b);
+            case '*': return _mm512_mul_pd(a, b);
+            case 'a': return _mm512_fmadd_pd(a, b, c);
+            case 's': return _mm512_fnmadd_pd(a, b, c);
+        }
+        return c;
+    }
+
+    template <char op>
+    inline __m512i laneStep(__m512i a, __m512i b, __m512i c) {
+        switch(op) {
+            case '+': return _mm512_add_epi32(a, b);
+            case '-': return _mm512_sub_epi32(a, b);
+            case '*': return _mm512_mullo_epi32(a, b);
+            case 'a': return _mm512_add_epi32(c, _mm512_mullo_epi32(a, b));
+            case 's': return _mm512_sub_epi32(c, _mm512_mullo_epi32(a, b));
+        }
+        return c;
+    }
+#endif
+
+    // Typed load / store / broadcast for the register holding width lanes of T,
+    // so array kernels can be written once per width.
+    template <typename T, int width>
+    struct laneRegister;
+
+#if defined(__SSE2__)
+    template <>
+    struct laneRegister<float, 4> {
+        typedef __m128 reg;
+        static inline reg load(const float *p) { return _mm_loadu_ps(p); }
+        static inline void store(float *p, reg v) { _mm_storeu_ps(p, v); }
+        static inline reg broadcast(float v) { return _mm_set1_ps(v); }
+        static inline reg zero() { return _mm_setzero_ps(); }
+    };
+
+    template <>
+    struct laneRegister<double, 2> {
+        typedef __m128d reg;
+        static inline reg load(const double *p) { return _mm_loadu_pd(p); }
+        static inline void store(double *p, reg v) { _mm_storeu_pd(p, v); }
+        static inline reg broadcast(double v) { return _mm_set1_pd(v); }
+        static inline reg zero() { return _mm_setzero_pd(); }
+    };
+#endif
+
+#if defined(__AVX__)
+    template <>
+    struct laneRegister<float, 8> {
+        typedef __m256 reg;
+        static inline reg load(const float *p) { return _mm256_loadu_ps(p); }
+        static inline void store(float *p, reg v) { _mm256_storeu_ps(p, v); }
+        static inline reg broadcast(float v) { return _mm256_set1_ps(v); }
+        static inline reg zero() { return _mm256_setzero_ps(); }
+    };
+
+    template <>
+    struct laneRegister<double, 4> {
+        typedef __m256d reg;
+        static inline reg load(const double *p) { return _mm256_loadu_pd(p); }
+        static inline void store(double *p, reg v) { _mm256_storeu_pd(p, v); }
+        static inline reg broadcast(double v) { return _mm256_set1_pd(v); }
+        static inline reg zero() { return _mm256_setzero_pd(); }
+    };
+#endif
+
+#if defined(__AVX512F__)
+    template <>
+    struct laneRegister<float, 16> {
+        typedef __m512 reg;
+        static inline reg load(const float *p) { return _mm512_loadu_ps(p); }
+        static inline void store(float *p, reg v) { _mm512_storeu_ps(p, v); }
+        static inline reg broadcast(float v) { return _mm512_set1_ps(v); }
+        static inline reg zero() { return _mm512_setzero_ps(); }
+    };
+
+    template <>
+    struct laneRegister<double, 8> {
+        typedef __m512d reg;
+        static inline reg load(const double *p) { return _mm512_loadu_pd(p); }
+        static inline void store(double *p, reg v) { _mm512_storeu_pd(p, v); }
+        static inline reg broadcast(double v) { return _mm512_set1_pd(v); }
+        static inline reg zero() { return _mm512_setzero_pd(); }
+    };
+#endif
+
+#if defined(__SSE2__)
+    template <>
+    struct laneRegister<int, 4> {
+        typedef __m128i reg;
+        static inline reg load(const int *p) { return _mm_loadu_si128((const __m128i*)p); }
+        static inline void store(int *p, reg v) { _mm_storeu_si128((__m128i*)p, v); }
+        static inline reg broadcast(int v) { return _mm_set1_epi32(v); }
+        static inline reg zero() { return _mm_setzero_si128(); }
+    };
+#endif
+
+#if defined(__AVX2__)
+    template <>
+    struct laneRegister<int, 8> {
+        typedef __m256i reg;
+        static inline reg load(const int *p) { return _mm256_loadu_si256((const __m256i*)p); }
+        static inline void store(int *p, reg v) { _mm256_storeu_si256((__m256i*)p, v); }
+        static inline reg broadcast(int v) { return _mm256_set1_epi32(v); }
+        static inline reg zero() { return _mm256_setzero_si256(); }
+    };
+#endif
+
+#if defined(__AVX512F__)
+    template <>
+    struct laneRegister<int, 16> {
+        typedef __m512i reg;
+        static inline reg load(const int *p) { return _mm512_loadu_si512((const void*)p); }
+        static inline void store(int *p, reg v) { _mm512_storeu_si512((void*)p, v); }
+        static inline reg broadcast(int v) { return _mm512_set1_epi32(v); }
+        static inline reg zero() { return _mm512_setzero_si512(); }
+    };
+#endif
+
+    // One lane at a time, for the scalar tails of kernels written against
+    // laneRegister.
+    template <typename T>
+    struct scalarLane {
+        typedef T reg;
+        static inline reg load(const T *p) { return *p; }
+        static inline void store(T *p, reg v) { *p = v; }
+        static inline reg broadcast(T v) { return v; }
+        static inline reg zero() { return 0; }
+    };
+
+    template <char op, typename T>
+    inline T scalarLaneStep(T a, T b, T c) {
+        switch(op) {
+            case '+': return a + b;
+            case '-': return a - b;
+            case '*': return a * b;
+            case 'a': return c + a * b;
+            case 's': return c - a * b;
+        }
+        return c;
+    }
+
+    template <char op>
+    inline float laneStep(float a, float b, float c) { return scalarLaneStep<op>(a, b, c); }
+
+    template <char op>
+    inline double laneStep(double a, double b, double c) { return scalarLaneStep<op>(a, b, c); }
+
+    template <char op>
+    inline int laneStep(int a, int b, int c) { return scalarLaneStep<op>(a, b, c); }
+
+    // Horner steps acc = acc * x + coefficients[index - 1], ..., coefficients[0],
+    // unrolled at compile time.
+    template <int index>
+    struct hornerUnroll {
+        template <typename Reg>
+        static inline Reg step(const Reg *coefficients, Reg x, Reg acc) {
+            return hornerUnroll<index - 1>::step(coefficients, x, laneStep<'a'>(acc, x, coefficients[index - 1]));
+        }
+    };
+
+    template <>
+    struct hornerUnroll<0> {
+        template <typename Reg>
+        static inline Reg step(const Reg *, Reg, Reg acc) {
+            return acc;
+        }
+    };
+
+}
+
+#endif